@@ -32,6 +32,75 @@ extern "C"
   void convertYUYVtoRGBYL(unsigned int w, unsigned int h, unsigned char const * src, int * dstrg,
                           int * dstby, int * dstlum, int thresh, int inputbits);
 
+  //! Convert from big-endian RGB565 to gray, for internal use. Use RawImage functions instead in most cases.
+  /*! Memory should have been allocated by caller. \ingroup image */
+  void convertRGB565toGray(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst);
+
+  //! Convert from big-endian RGB565 to BGR24, for internal use. Use RawImage functions instead in most cases.
+  /*! Memory should have been allocated by caller. \ingroup image */
+  void convertRGB565toBGR(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst);
+
+  //! Convert from big-endian RGB565 to RGB24, for internal use. Use RawImage functions instead in most cases.
+  /*! Memory should have been allocated by caller. \ingroup image */
+  void convertRGB565toRGB(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst);
+
+  //! Convert from YUYV to gray while downscaling by factor, for internal use. Use RawImage functions instead.
+  /*! w and h are the input dimensions. Each output pixel is the average of a factor x factor block of input pixels, so
+      that the output is (w / factor) x (h / factor). Optimized for factors 2 and 4. Memory should have been allocated
+      by caller. \ingroup image */
+  void convertYUYVtoGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                             unsigned int factor);
+
+  //! Convert from YUYV to BGR24 while downscaling by an even factor, for internal use
+  /*! Uses the same BT.601 video range coefficients as cv::cvtColor(CV_YUV2BGR_YUYV), so that results match a
+      full-resolution conversion. See convertYUYVtoGrayDown(). \ingroup image */
+  void convertYUYVtoBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                            unsigned int factor);
+
+  //! Convert from big-endian RGB565 to gray while downscaling by factor, for internal use
+  /*! See convertYUYVtoGrayDown(). \ingroup image */
+  void convertRGB565toGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                               unsigned int factor);
+
+  //! Convert from big-endian RGB565 to BGR24 while downscaling by factor, for internal use
+  /*! See convertYUYVtoGrayDown(). \ingroup image */
+  void convertRGB565toBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                              unsigned int factor);
+
+  //! Convert from RGGB Bayer (V4L2_PIX_FMT_SRGGB8) to gray while downscaling by an even factor, for internal use
+  /*! Colors are obtained directly from the 2x2 Bayer cells, without interpolation. See convertYUYVtoGrayDown().
+      \ingroup image */
+  void convertBayertoGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                              unsigned int factor);
+
+  //! Convert from RGGB Bayer (V4L2_PIX_FMT_SRGGB8) to BGR24 while downscaling by an even factor, for internal use
+  /*! See convertBayertoGrayDown(). \ingroup image */
+  void convertBayertoBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                             unsigned int factor);
+
+  //! SIMD instruction sets that may be used by the color conversion functions
+  /*! All variants produce bit-exact identical results. \ingroup image */
+  enum colorConversionSimdType
+  {
+    COLOR_CONVERSION_SCALAR = 0, //!< Plain C code
+    COLOR_CONVERSION_NEON = 1,   //!< ARM NEON, always used on platform
+    COLOR_CONVERSION_SSSE3 = 2,  //!< Intel SSSE3, used on host since we compile it with -msse4
+    COLOR_CONVERSION_AVX2 = 3    //!< Intel AVX2, used on host if the CPU supports it
+  };
+
+  //! Get the fastest SIMD instruction set available at runtime for color conversions
+  /*! This is selected automatically when the library is loaded. \ingroup image */
+  int colorConversionBestSimd(void);
+
+  //! Get the SIMD instruction set currently used by the color conversion functions
+  /*! \ingroup image */
+  int colorConversionGetSimd(void);
+
+  //! Select the SIMD instruction set used by the color conversion functions, mainly for testing and benchmarking
+  /*! If the requested set is not available, SSSE3 is used instead of AVX2, and scalar code in all other cases. Returns
+      the set that was actually selected. Not thread-safe, do not call while conversions are running. \ingroup image */
+  int colorConversionSetSimd(int simd);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,40 +17,542 @@
 
 #include <jevois/Image/ColorConversion.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define JEVOIS_CC_NEON
+#elif defined(__SSSE3__)
+#include <immintrin.h>
+#define JEVOIS_CC_SSSE3
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JEVOIS_CC_AVX2
+#endif
+#endif
+
 #define CLAMP(value) if (value < 0) value = 0; else if (value > 255) value = 255;
 
+// YUV to RGB fixed-point coefficients, shared by the scalar and SIMD kernels so that they stay bit-exact:
+#define K1 ((int)(1.402f * (1 << 16)))
+#define K2 ((int)(0.714f * (1 << 16)))
+#define K3 ((int)(0.334f * (1 << 16)))
+#define K4 ((int)(1.772f * (1 << 16)))
+
+// The SIMD kernels only have 16-bit multiply-high instructions. (K * v) >> 16 is computed exactly as follows:
+// K1 * v >> 16 = v + mulhi(v, K1 - 65536)
+// K2 * v >> 16 = mulhi(2 * v, K2 / 2)           (K2 is even)
+// K3 * v >> 16 = mulhi(v, K3)
+// K4 * v >> 16 = 2 * v + mulhi(v, K4 - 131072)
+#define K1S ((short)(K1 - 65536))
+#define K2S ((short)(K2 / 2))
+#define K3S ((short)(K3))
+#define K4S ((short)(K4 - 131072))
+
+// Currently selected SIMD kernel set, see colorConversionSetSimd():
+static int colorConversionSimd = COLOR_CONVERSION_SCALAR;
+
 // ####################################################################################################
-void convertYUYVtoRGB24(unsigned int w, unsigned int h, unsigned char const * srcptr, unsigned char * dstptr)
+// Scalar kernels. They also process the leftover pixels at the end of the SIMD kernels.
+// ####################################################################################################
+static void yuyvToRGB24scalar(unsigned int npix, unsigned char const * srcptr, unsigned char * dstptr)
 {
-  // FIXME This code does not work if w is odd
-  const int K1 = (int)(1.402f * (1 << 16));
-  const int K2 = (int)(0.714f * (1 << 16));
-  const int K3 = (int)(0.334f * (1 << 16));
-  const int K4 = (int)(1.772f * (1 << 16));
-  const unsigned int pitch = w * 2; // 2 bytes per one YU-YV pixel
-  unsigned int x, y;
+  unsigned int x;
   unsigned char Y1, Y2;
   int uf, vf, R, G, B;
   
-  for (y = 0; y < h; ++y)
+  for (x = 0; x < npix; x += 2)  // Y1 U Y2 V
+  {
+    Y1 = *srcptr++; uf = *srcptr++ - 128; Y2 = *srcptr++; vf = *srcptr++ - 128;
+    
+    R = Y1 + (K1 * vf >> 16);
+    G = Y1 - (K2 * vf >> 16) - (K3 * uf >> 16);
+    B = Y1 + (K4 * uf >> 16);
+    CLAMP(R); CLAMP(G); CLAMP(B);
+    *dstptr++ = (unsigned char)(R); *dstptr++ = (unsigned char)(G); *dstptr++ = (unsigned char)(B);
+    
+    R = Y2 + (K1 * vf >> 16);
+    G = Y2 - (K2 * vf >> 16) - (K3 * uf >> 16);
+    B = Y2 + (K4 * uf >> 16);
+    CLAMP(R); CLAMP(G); CLAMP(B);
+    *dstptr++ = (unsigned char)(R); *dstptr++ = (unsigned char)(G); *dstptr++ = (unsigned char)(B);
+  }
+}
+
+// ####################################################################################################
+static inline void rgb565pixrgb(unsigned char const * src, unsigned char * r, unsigned char * g, unsigned char * b)
+{
+  unsigned short const rgb565 = ((unsigned short)(src[0]) << 8) | src[1]; // big-endian
+  *r = ((((rgb565 >> 11) & 0x1F) * 527) + 23) >> 6;
+  *g = ((((rgb565 >> 5) & 0x3F) * 259) + 33) >> 6;
+  *b = (((rgb565 & 0x1F) * 527) + 23) >> 6;
+}
+
+// ####################################################################################################
+static void rgb565ToGrayscalar(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i; unsigned char r, g, b;
+  for (i = 0; i < npix; ++i, src += 2) { rgb565pixrgb(src, &r, &g, &b); *dst++ = (int)(r + g + b) / 3; }
+}
+
+// ####################################################################################################
+static void rgb565ToBGRscalar(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i; unsigned char r, g, b;
+  for (i = 0; i < npix; ++i, src += 2) { rgb565pixrgb(src, &r, &g, &b); *dst++ = b; *dst++ = g; *dst++ = r; }
+}
+
+// ####################################################################################################
+static void rgb565ToRGBscalar(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i; unsigned char r, g, b;
+  for (i = 0; i < npix; ++i, src += 2) { rgb565pixrgb(src, &r, &g, &b); *dst++ = r; *dst++ = g; *dst++ = b; }
+}
+
+#ifdef JEVOIS_CC_NEON
+// ####################################################################################################
+// ARM NEON kernels, used on the platform (Cortex-A7, compiled with -mfpu=neon-vfpv4)
+// ####################################################################################################
+// Exact (a * k) >> 16 on 8 signed shorts
+static inline int16x8_t mulhi_neon(int16x8_t a, short k)
+{
+  int16x4_t const kk = vdup_n_s16(k);
+  return vcombine_s16(vshrn_n_s32(vmull_s16(vget_low_s16(a), kk), 16),
+                      vshrn_n_s32(vmull_s16(vget_high_s16(a), kk), 16));
+}
+
+// ####################################################################################################
+static void yuyvToRGB24neon(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  int16x8_t const c128 = vdupq_n_s16(128);
+  unsigned int x;
+
+  for (x = 0; x + 32 <= npix; x += 32, src += 64, dst += 96)
   {
-    for (x = 0; x < pitch; x += 4)  // Y1 U Y2 V
+    // Load and deinterleave 32 pixels: val[0] = even Y, val[1] = U, val[2] = odd Y, val[3] = V
+    uint8x16x4_t const in = vld4q_u8(src);
+    uint8x16x3_t rgb[2];
+    int half;
+
+    for (half = 0; half < 2; ++half)
     {
-      Y1 = *srcptr++; uf = *srcptr++ - 128; Y2 = *srcptr++; vf = *srcptr++ - 128;
- 
-      R = Y1 + (K1 * vf >> 16);
-      G = Y1 - (K2 * vf >> 16) - (K3 * uf >> 16);
-      B = Y1 + (K4 * uf >> 16);
-      CLAMP(R); CLAMP(G); CLAMP(B);
-      *dstptr++ = (unsigned char)(R); *dstptr++ = (unsigned char)(G); *dstptr++ = (unsigned char)(B);
- 
-      R = Y2 + (K1 * vf >> 16);
-      G = Y2 - (K2 * vf >> 16) - (K3 * uf >> 16);
-      B = Y2 + (K4 * uf >> 16);
-      CLAMP(R); CLAMP(G); CLAMP(B);
-      *dstptr++ = (unsigned char)(R); *dstptr++ = (unsigned char)(G); *dstptr++ = (unsigned char)(B);
+      uint8x8_t const y0 = half ? vget_high_u8(in.val[0]) : vget_low_u8(in.val[0]);
+      uint8x8_t const u8 = half ? vget_high_u8(in.val[1]) : vget_low_u8(in.val[1]);
+      uint8x8_t const y1 = half ? vget_high_u8(in.val[2]) : vget_low_u8(in.val[2]);
+      uint8x8_t const v8 = half ? vget_high_u8(in.val[3]) : vget_low_u8(in.val[3]);
+
+      int16x8_t const uf = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), c128);
+      int16x8_t const vf = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), c128);
+
+      int16x8_t const rd = vaddq_s16(vf, mulhi_neon(vf, K1S));
+      int16x8_t const gd = vaddq_s16(mulhi_neon(vshlq_n_s16(vf, 1), K2S), mulhi_neon(uf, K3S));
+      int16x8_t const bd = vaddq_s16(vshlq_n_s16(uf, 1), mulhi_neon(uf, K4S));
+
+      int16x8_t const ye = vreinterpretq_s16_u16(vmovl_u8(y0));
+      int16x8_t const yo = vreinterpretq_s16_u16(vmovl_u8(y1));
+
+      // Saturating narrowing does the clamping to [0..255]; zip even and odd pixels back into sequence:
+      uint8x8x2_t const r = vzip_u8(vqmovun_s16(vaddq_s16(ye, rd)), vqmovun_s16(vaddq_s16(yo, rd)));
+      uint8x8x2_t const g = vzip_u8(vqmovun_s16(vsubq_s16(ye, gd)), vqmovun_s16(vsubq_s16(yo, gd)));
+      uint8x8x2_t const b = vzip_u8(vqmovun_s16(vaddq_s16(ye, bd)), vqmovun_s16(vaddq_s16(yo, bd)));
+
+      rgb[half].val[0] = vcombine_u8(r.val[0], r.val[1]);
+      rgb[half].val[1] = vcombine_u8(g.val[0], g.val[1]);
+      rgb[half].val[2] = vcombine_u8(b.val[0], b.val[1]);
     }
+
+    vst3q_u8(dst, rgb[0]);
+    vst3q_u8(dst + 48, rgb[1]);
+  }
+
+  yuyvToRGB24scalar(npix - x, src, dst);
+}
+
+// ####################################################################################################
+// Load 16 big-endian RGB565 pixels and expand them to 8-bit r, g, b
+static inline void rgb565load_neon(unsigned char const * src, uint8x16_t * r, uint8x16_t * g, uint8x16_t * b)
+{
+  uint8x16x2_t const in = vld2q_u8(src); // val[0] = high bytes, val[1] = low bytes
+  uint8x16_t const r5 = vshrq_n_u8(in.val[0], 3);
+  uint8x16_t const g6 = vorrq_u8(vshlq_n_u8(vandq_u8(in.val[0], vdupq_n_u8(7)), 3), vshrq_n_u8(in.val[1], 5));
+  uint8x16_t const b5 = vandq_u8(in.val[1], vdupq_n_u8(0x1F));
+  uint16x8_t const c23 = vdupq_n_u16(23), c33 = vdupq_n_u16(33);
+
+#define JEVOIS_CC_EXPAND(x, mul, add)                                   \
+  vcombine_u8(vshrn_n_u16(vaddq_u16(vmulq_n_u16(vmovl_u8(vget_low_u8(x)), mul), add), 6), \
+              vshrn_n_u16(vaddq_u16(vmulq_n_u16(vmovl_u8(vget_high_u8(x)), mul), add), 6))
+
+  *r = JEVOIS_CC_EXPAND(r5, 527, c23);
+  *g = JEVOIS_CC_EXPAND(g6, 259, c33);
+  *b = JEVOIS_CC_EXPAND(b5, 527, c23);
+
+#undef JEVOIS_CC_EXPAND
+}
+
+// ####################################################################################################
+// Exact n / 3 for n <= 765, as (n * 43691) >> 17
+static inline uint8x8_t div3_neon(uint16x8_t n)
+{
+  uint16x4_t const k = vdup_n_u16(43691);
+  return vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(vmull_u16(vget_low_u16(n), k), 17)),
+                                vmovn_u32(vshrq_n_u32(vmull_u16(vget_high_u16(n), k), 17))));
+}
+
+// ####################################################################################################
+static void rgb565ToGrayneon(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 16 <= npix; i += 16, src += 32, dst += 16)
+  {
+    uint8x16_t r, g, b; rgb565load_neon(src, &r, &g, &b);
+    uint16x8_t const lo = vaddw_u8(vaddl_u8(vget_low_u8(r), vget_low_u8(g)), vget_low_u8(b));
+    uint16x8_t const hi = vaddw_u8(vaddl_u8(vget_high_u8(r), vget_high_u8(g)), vget_high_u8(b));
+    vst1q_u8(dst, vcombine_u8(div3_neon(lo), div3_neon(hi)));
+  }
+  rgb565ToGrayscalar(npix - i, src, dst);
+}
+
+// ####################################################################################################
+static void rgb565ToBGRneon(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 16 <= npix; i += 16, src += 32, dst += 48)
+  {
+    uint8x16x3_t out; rgb565load_neon(src, &out.val[2], &out.val[1], &out.val[0]);
+    vst3q_u8(dst, out);
+  }
+  rgb565ToBGRscalar(npix - i, src, dst);
+}
+
+// ####################################################################################################
+static void rgb565ToRGBneon(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 16 <= npix; i += 16, src += 32, dst += 48)
+  {
+    uint8x16x3_t out; rgb565load_neon(src, &out.val[0], &out.val[1], &out.val[2]);
+    vst3q_u8(dst, out);
+  }
+  rgb565ToRGBscalar(npix - i, src, dst);
+}
+#endif // JEVOIS_CC_NEON
+
+#ifdef JEVOIS_CC_SSSE3
+// ####################################################################################################
+// Intel SSSE3 kernels, used on the host (compiled with -msse4)
+// ####################################################################################################
+// Interleave 16 bytes from each of a, b, c into 48 bytes a0 b0 c0 a1 b1 c1 ... stored at dst
+static inline void store3_ssse3(unsigned char * dst, __m128i a, __m128i b, __m128i c)
+{
+  __m128i const a0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+  __m128i const b0 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+  __m128i const c0 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+  __m128i const a1 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+  __m128i const b1 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+  __m128i const c1 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+  __m128i const a2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+  __m128i const b2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+  __m128i const c2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+  _mm_storeu_si128((__m128i *)(dst),
+                   _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, a0), _mm_shuffle_epi8(b, b0)),
+                                _mm_shuffle_epi8(c, c0)));
+  _mm_storeu_si128((__m128i *)(dst + 16),
+                   _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, a1), _mm_shuffle_epi8(b, b1)),
+                                _mm_shuffle_epi8(c, c1)));
+  _mm_storeu_si128((__m128i *)(dst + 32),
+                   _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, a2), _mm_shuffle_epi8(b, b2)),
+                                _mm_shuffle_epi8(c, c2)));
+}
+
+// ####################################################################################################
+// Convert 8 YUYV pixels (16 bytes) to 16-bit R, G, B
+static inline void yuyv8_ssse3(__m128i in, __m128i * r, __m128i * g, __m128i * b)
+{
+  __m128i const ushuf = _mm_setr_epi8(1, -1, 1, -1, 5, -1, 5, -1, 9, -1, 9, -1, 13, -1, 13, -1);
+  __m128i const vshuf = _mm_setr_epi8(3, -1, 3, -1, 7, -1, 7, -1, 11, -1, 11, -1, 15, -1, 15, -1);
+  __m128i const c128 = _mm_set1_epi16(128);
+
+  __m128i const y = _mm_and_si128(in, _mm_set1_epi16(0xFF));
+  __m128i const uf = _mm_sub_epi16(_mm_shuffle_epi8(in, ushuf), c128);
+  __m128i const vf = _mm_sub_epi16(_mm_shuffle_epi8(in, vshuf), c128);
+
+  *r = _mm_add_epi16(y, _mm_add_epi16(vf, _mm_mulhi_epi16(vf, _mm_set1_epi16(K1S))));
+  *g = _mm_sub_epi16(_mm_sub_epi16(y, _mm_mulhi_epi16(_mm_slli_epi16(vf, 1), _mm_set1_epi16(K2S))),
+                     _mm_mulhi_epi16(uf, _mm_set1_epi16(K3S)));
+  *b = _mm_add_epi16(y, _mm_add_epi16(_mm_slli_epi16(uf, 1), _mm_mulhi_epi16(uf, _mm_set1_epi16(K4S))));
+}
+
+// ####################################################################################################
+static void yuyvToRGB24ssse3(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int x;
+  for (x = 0; x + 16 <= npix; x += 16, src += 32, dst += 48)
+  {
+    __m128i r0, g0, b0, r1, g1, b1;
+    yuyv8_ssse3(_mm_loadu_si128((__m128i const *)(src)), &r0, &g0, &b0);
+    yuyv8_ssse3(_mm_loadu_si128((__m128i const *)(src + 16)), &r1, &g1, &b1);
+
+    // Saturating pack does the clamping to [0..255]:
+    store3_ssse3(dst, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1));
+  }
+
+  yuyvToRGB24scalar(npix - x, src, dst);
+}
+
+// ####################################################################################################
+// Load 8 big-endian RGB565 pixels and expand them to 16-bit r, g, b
+static inline void rgb565load_ssse3(__m128i in, __m128i * r, __m128i * g, __m128i * b)
+{
+  __m128i const v = _mm_or_si128(_mm_slli_epi16(in, 8), _mm_srli_epi16(in, 8));
+  __m128i const m5 = _mm_set1_epi16(0x1F);
+  __m128i const c527 = _mm_set1_epi16(527), c23 = _mm_set1_epi16(23);
+
+  *r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(v, 11), c527), c23), 6);
+  *g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 5), _mm_set1_epi16(0x3F)),
+                                                    _mm_set1_epi16(259)), _mm_set1_epi16(33)), 6);
+  *b = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(v, m5), c527), c23), 6);
+}
+
+// ####################################################################################################
+// Exact n / 3 for n <= 765, as (n * 43691) >> 17
+static inline __m128i div3_ssse3(__m128i n)
+{ return _mm_srli_epi16(_mm_mulhi_epu16(n, _mm_set1_epi16((short)43691)), 1); }
+
+// ####################################################################################################
+static void rgb565ToGrayssse3(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 16 <= npix; i += 16, src += 32, dst += 16)
+  {
+    __m128i r0, g0, b0, r1, g1, b1;
+    rgb565load_ssse3(_mm_loadu_si128((__m128i const *)(src)), &r0, &g0, &b0);
+    rgb565load_ssse3(_mm_loadu_si128((__m128i const *)(src + 16)), &r1, &g1, &b1);
+    __m128i const l0 = div3_ssse3(_mm_add_epi16(_mm_add_epi16(r0, g0), b0));
+    __m128i const l1 = div3_ssse3(_mm_add_epi16(_mm_add_epi16(r1, g1), b1));
+    _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(l0, l1));
+  }
+  rgb565ToGrayscalar(npix - i, src, dst);
+}
+
+// ####################################################################################################
+static void rgb565ToBGRssse3(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 16 <= npix; i += 16, src += 32, dst += 48)
+  {
+    __m128i r0, g0, b0, r1, g1, b1;
+    rgb565load_ssse3(_mm_loadu_si128((__m128i const *)(src)), &r0, &g0, &b0);
+    rgb565load_ssse3(_mm_loadu_si128((__m128i const *)(src + 16)), &r1, &g1, &b1);
+    store3_ssse3(dst, _mm_packus_epi16(b0, b1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(r0, r1));
+  }
+  rgb565ToBGRscalar(npix - i, src, dst);
+}
+
+// ####################################################################################################
+static void rgb565ToRGBssse3(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 16 <= npix; i += 16, src += 32, dst += 48)
+  {
+    __m128i r0, g0, b0, r1, g1, b1;
+    rgb565load_ssse3(_mm_loadu_si128((__m128i const *)(src)), &r0, &g0, &b0);
+    rgb565load_ssse3(_mm_loadu_si128((__m128i const *)(src + 16)), &r1, &g1, &b1);
+    store3_ssse3(dst, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1));
+  }
+  rgb565ToRGBscalar(npix - i, src, dst);
+}
+#endif // JEVOIS_CC_SSSE3
+
+#ifdef JEVOIS_CC_AVX2
+// ####################################################################################################
+// Intel AVX2 kernels, compiled for AVX2 regardless of host flags and only used if the CPU supports it
+// ####################################################################################################
+#define JEVOIS_AVX2 __attribute__((target("avx2")))
+
+// Saturating pack of 2x16 shorts into 32 bytes, in sequential order (undo the per-lane interleave of packus):
+JEVOIS_AVX2 static inline __m256i packus_avx2(__m256i a, __m256i b)
+{ return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8); }
+
+// ####################################################################################################
+JEVOIS_AVX2 static inline void store3_avx2(unsigned char * dst, __m256i a, __m256i b, __m256i c)
+{
+  store3_ssse3(dst, _mm256_castsi256_si128(a), _mm256_castsi256_si128(b), _mm256_castsi256_si128(c));
+  store3_ssse3(dst + 48, _mm256_extracti128_si256(a, 1), _mm256_extracti128_si256(b, 1),
+               _mm256_extracti128_si256(c, 1));
+}
+
+// ####################################################################################################
+JEVOIS_AVX2 static inline void yuyv16_avx2(__m256i in, __m256i * r, __m256i * g, __m256i * b)
+{
+  __m256i const ushuf = _mm256_setr_epi8(1, -1, 1, -1, 5, -1, 5, -1, 9, -1, 9, -1, 13, -1, 13, -1,
+                                         1, -1, 1, -1, 5, -1, 5, -1, 9, -1, 9, -1, 13, -1, 13, -1);
+  __m256i const vshuf = _mm256_setr_epi8(3, -1, 3, -1, 7, -1, 7, -1, 11, -1, 11, -1, 15, -1, 15, -1,
+                                         3, -1, 3, -1, 7, -1, 7, -1, 11, -1, 11, -1, 15, -1, 15, -1);
+  __m256i const c128 = _mm256_set1_epi16(128);
+
+  __m256i const y = _mm256_and_si256(in, _mm256_set1_epi16(0xFF));
+  __m256i const uf = _mm256_sub_epi16(_mm256_shuffle_epi8(in, ushuf), c128);
+  __m256i const vf = _mm256_sub_epi16(_mm256_shuffle_epi8(in, vshuf), c128);
+
+  *r = _mm256_add_epi16(y, _mm256_add_epi16(vf, _mm256_mulhi_epi16(vf, _mm256_set1_epi16(K1S))));
+  *g = _mm256_sub_epi16(_mm256_sub_epi16(y, _mm256_mulhi_epi16(_mm256_slli_epi16(vf, 1), _mm256_set1_epi16(K2S))),
+                        _mm256_mulhi_epi16(uf, _mm256_set1_epi16(K3S)));
+  *b = _mm256_add_epi16(y, _mm256_add_epi16(_mm256_slli_epi16(uf, 1),
+                                            _mm256_mulhi_epi16(uf, _mm256_set1_epi16(K4S))));
+}
+
+// ####################################################################################################
+JEVOIS_AVX2 static void yuyvToRGB24avx2(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int x;
+  for (x = 0; x + 32 <= npix; x += 32, src += 64, dst += 96)
+  {
+    __m256i r0, g0, b0, r1, g1, b1;
+    yuyv16_avx2(_mm256_loadu_si256((__m256i const *)(src)), &r0, &g0, &b0);
+    yuyv16_avx2(_mm256_loadu_si256((__m256i const *)(src + 32)), &r1, &g1, &b1);
+    store3_avx2(dst, packus_avx2(r0, r1), packus_avx2(g0, g1), packus_avx2(b0, b1));
+  }
+
+  yuyvToRGB24ssse3(npix - x, src, dst);
+}
+
+// ####################################################################################################
+JEVOIS_AVX2 static inline void rgb565load_avx2(__m256i in, __m256i * r, __m256i * g, __m256i * b)
+{
+  __m256i const v = _mm256_or_si256(_mm256_slli_epi16(in, 8), _mm256_srli_epi16(in, 8));
+  __m256i const m5 = _mm256_set1_epi16(0x1F);
+  __m256i const c527 = _mm256_set1_epi16(527), c23 = _mm256_set1_epi16(23);
+
+  *r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_srli_epi16(v, 11), c527), c23), 6);
+  *g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(v, 5),
+                                                                              _mm256_set1_epi16(0x3F)),
+                                                             _mm256_set1_epi16(259)), _mm256_set1_epi16(33)), 6);
+  *b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_and_si256(v, m5), c527), c23), 6);
+}
+
+// ####################################################################################################
+JEVOIS_AVX2 static void rgb565ToGrayavx2(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  __m256i const k = _mm256_set1_epi16((short)43691);
+  unsigned int i;
+  for (i = 0; i + 32 <= npix; i += 32, src += 64, dst += 32)
+  {
+    __m256i r0, g0, b0, r1, g1, b1;
+    rgb565load_avx2(_mm256_loadu_si256((__m256i const *)(src)), &r0, &g0, &b0);
+    rgb565load_avx2(_mm256_loadu_si256((__m256i const *)(src + 32)), &r1, &g1, &b1);
+    __m256i const l0 = _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_add_epi16(_mm256_add_epi16(r0, g0), b0), k), 1);
+    __m256i const l1 = _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_add_epi16(_mm256_add_epi16(r1, g1), b1), k), 1);
+    _mm256_storeu_si256((__m256i *)dst, packus_avx2(l0, l1));
+  }
+  rgb565ToGrayssse3(npix - i, src, dst);
+}
+
+// ####################################################################################################
+JEVOIS_AVX2 static void rgb565ToBGRavx2(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 32 <= npix; i += 32, src += 64, dst += 96)
+  {
+    __m256i r0, g0, b0, r1, g1, b1;
+    rgb565load_avx2(_mm256_loadu_si256((__m256i const *)(src)), &r0, &g0, &b0);
+    rgb565load_avx2(_mm256_loadu_si256((__m256i const *)(src + 32)), &r1, &g1, &b1);
+    store3_avx2(dst, packus_avx2(b0, b1), packus_avx2(g0, g1), packus_avx2(r0, r1));
+  }
+  rgb565ToBGRssse3(npix - i, src, dst);
+}
+
+// ####################################################################################################
+JEVOIS_AVX2 static void rgb565ToRGBavx2(unsigned int npix, unsigned char const * src, unsigned char * dst)
+{
+  unsigned int i;
+  for (i = 0; i + 32 <= npix; i += 32, src += 64, dst += 96)
+  {
+    __m256i r0, g0, b0, r1, g1, b1;
+    rgb565load_avx2(_mm256_loadu_si256((__m256i const *)(src)), &r0, &g0, &b0);
+    rgb565load_avx2(_mm256_loadu_si256((__m256i const *)(src + 32)), &r1, &g1, &b1);
+    store3_avx2(dst, packus_avx2(r0, r1), packus_avx2(g0, g1), packus_avx2(b0, b1));
+  }
+  rgb565ToRGBssse3(npix - i, src, dst);
+}
+#endif // JEVOIS_CC_AVX2
+
+// ####################################################################################################
+// Runtime dispatch
+// ####################################################################################################
+typedef void (*colorConversionKernel)(unsigned int npix, unsigned char const * src, unsigned char * dst);
+
+static colorConversionKernel yuyvToRGB24kernel = yuyvToRGB24scalar;
+static colorConversionKernel rgb565ToGraykernel = rgb565ToGrayscalar;
+static colorConversionKernel rgb565ToBGRkernel = rgb565ToBGRscalar;
+static colorConversionKernel rgb565ToRGBkernel = rgb565ToRGBscalar;
+
+// ####################################################################################################
+int colorConversionBestSimd(void)
+{
+#if defined(JEVOIS_CC_NEON)
+  return COLOR_CONVERSION_NEON;
+#else
+#if defined(JEVOIS_CC_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return COLOR_CONVERSION_AVX2;
+#endif
+#if defined(JEVOIS_CC_SSSE3)
+  return COLOR_CONVERSION_SSSE3;
+#endif
+  return COLOR_CONVERSION_SCALAR;
+#endif
+}
+
+// ####################################################################################################
+int colorConversionGetSimd(void)
+{ return colorConversionSimd; }
+
+// ####################################################################################################
+int colorConversionSetSimd(int simd)
+{
+  // AVX2 is only used if the CPU supports it, otherwise fall back to SSSE3, which the host build requires anyway:
+  if (simd == COLOR_CONVERSION_AVX2 && colorConversionBestSimd() != COLOR_CONVERSION_AVX2)
+    simd = COLOR_CONVERSION_SSSE3;
+
+  switch (simd)
+  {
+#ifdef JEVOIS_CC_NEON
+  case COLOR_CONVERSION_NEON:
+    yuyvToRGB24kernel = yuyvToRGB24neon; rgb565ToGraykernel = rgb565ToGrayneon;
+    rgb565ToBGRkernel = rgb565ToBGRneon; rgb565ToRGBkernel = rgb565ToRGBneon;
+    break;
+#endif
+#ifdef JEVOIS_CC_SSSE3
+  case COLOR_CONVERSION_SSSE3:
+    yuyvToRGB24kernel = yuyvToRGB24ssse3; rgb565ToGraykernel = rgb565ToGrayssse3;
+    rgb565ToBGRkernel = rgb565ToBGRssse3; rgb565ToRGBkernel = rgb565ToRGBssse3;
+    break;
+#endif
+#ifdef JEVOIS_CC_AVX2
+  case COLOR_CONVERSION_AVX2:
+    yuyvToRGB24kernel = yuyvToRGB24avx2; rgb565ToGraykernel = rgb565ToGrayavx2;
+    rgb565ToBGRkernel = rgb565ToBGRavx2; rgb565ToRGBkernel = rgb565ToRGBavx2;
+    break;
+#endif
+  default:
+    simd = COLOR_CONVERSION_SCALAR;
+    yuyvToRGB24kernel = yuyvToRGB24scalar; rgb565ToGraykernel = rgb565ToGrayscalar;
+    rgb565ToBGRkernel = rgb565ToBGRscalar; rgb565ToRGBkernel = rgb565ToRGBscalar;
   }
+
+  colorConversionSimd = simd;
+  return simd;
+}
+
+// ####################################################################################################
+// Select the best kernels when the library is loaded:
+__attribute__((constructor)) static void colorConversionInit(void)
+{ colorConversionSetSimd(colorConversionBestSimd()); }
+
+// ####################################################################################################
+void convertYUYVtoRGB24(unsigned int w, unsigned int h, unsigned char const * srcptr, unsigned char * dstptr)
+{
+  // FIXME This code does not work if w is odd
+  if (w & 1) yuyvToRGB24scalar((w + 1) * h, srcptr, dstptr);
+  else yuyvToRGB24kernel(w * h, srcptr, dstptr); // rows are contiguous in src and dst, convert all at once
 }
 
 // ####################################################################################################
@@ -90,39 +592,197 @@ void convertYUYVtoRGBYL(unsigned int w, unsigned int h, unsigned char const * sr
                         int * dstby, int * dstlum, int thresh, int inputbits)
 {
   // FIXME This code does not work if w is odd
-  const int K1 = (int)(1.402f * (1 << 16));
-  const int K2 = (int)(0.714f * (1 << 16));
-  const int K3 = (int)(0.334f * (1 << 16));
-  const int K4 = (int)(1.772f * (1 << 16));
-  const unsigned int pitch = w * 2; // 2 bytes per one YU-YV pixel
+  const unsigned int npix = (w + 1) & ~1U; // pixels per row, we process them in YU-YV pairs
   const int lshift = inputbits - 3; // FIXME assumes inputbits > 3
   const int lumlshift = inputbits - 8; // FIXME assumes inputbits > 8; why two different shifts?
 
-  unsigned int x, y;
-  unsigned char Y1, Y2;
-  int uf, vf, R, G, B;
-  
+  // The YUV to RGB part is done by the (possibly SIMD) RGB24 kernel, in chunks that fit in a small buffer. The
+  // opponent colors need per-pixel integer divisions and remain scalar. RGB24 values are already clamped, so results
+  // are unchanged:
+  unsigned char rgb[256 * 3];
+  unsigned int x, y, i, n;
+
   for (y = 0; y < h; ++y)
-  {
-    for (x = 0; x < pitch; x += 4)  // Y1 U Y2 V
+    for (x = 0; x < npix; x += n)
     {
-      Y1 = *srcptr++; uf = *srcptr++ - 128; Y2 = *srcptr++; vf = *srcptr++ - 128;
- 
-      R = Y1 + (K1 * vf >> 16);
-      G = Y1 - (K2 * vf >> 16) - (K3 * uf >> 16);
-      B = Y1 + (K4 * uf >> 16);
+      n = npix - x; if (n > 256) n = 256;
+      yuyvToRGB24kernel(n, srcptr, rgb);
+      srcptr += n * 2;
+
+      for (i = 0; i < n * 3; i += 3)
+      {
+        convertYUYVtoRGBYLinternal(rgb[i], rgb[i + 1], rgb[i + 2], dstrg, dstby, dstlum, thresh, lshift, lumlshift);
+        ++dstrg; ++dstby; ++dstlum;
+      }
+    }
+}
 
-      convertYUYVtoRGBYLinternal(R, G, B, dstrg, dstby, dstlum, thresh, lshift, lumlshift);
+// ####################################################################################################
+void convertRGB565toGray(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst)
+{ rgb565ToGraykernel(w * h, src, dst); }
 
-      ++dstrg; ++dstby; ++dstlum;
- 
-      R = Y2 + (K1 * vf >> 16);
-      G = Y2 - (K2 * vf >> 16) - (K3 * uf >> 16);
-      B = Y2 + (K4 * uf >> 16);
+// ####################################################################################################
+void convertRGB565toBGR(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst)
+{ rgb565ToBGRkernel(w * h, src, dst); }
 
-      convertYUYVtoRGBYLinternal(R, G, B, dstrg, dstby, dstlum, thresh, lshift, lumlshift);
+// ####################################################################################################
+void convertRGB565toRGB(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst)
+{ rgb565ToRGBkernel(w * h, src, dst); }
 
-      ++dstrg; ++dstby; ++dstlum;
-    }
+// ####################################################################################################
+// Fused conversion and downscaling kernels. Each output pixel is the rounded average of a factor x factor block of
+// input pixels; leftover input rows and columns are ignored. These are plain C, written so that the compiler
+// specializes them for factors 2 and 4 (see the switch statements below) and vectorizes the inner loops. This is
+// enough since they read each input pixel only once and are limited by memory bandwidth.
+// ####################################################################################################
+#define DOWN_DISPATCH(kernel)                                           \
+  switch (factor)                                                       \
+  {                                                                     \
+  case 2: kernel(w, h, src, dst, 2); break;                             \
+  case 4: kernel(w, h, src, dst, 4); break;                             \
+  default: kernel(w, h, src, dst, factor);                              \
   }
+
+// ####################################################################################################
+static inline __attribute__((always_inline))
+void yuyvToGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f)
+{
+  unsigned int const ow = w / f, oh = h / f, n = f * f, stride = w * 2;
+  unsigned int x, y, i, j, sum;
+
+  for (y = 0; y < oh; ++y, src += stride * f)
+    for (x = 0; x < ow; ++x)
+    {
+      unsigned char const * s = src + x * f * 2;
+      sum = 0;
+      for (j = 0; j < f; ++j, s += stride) for (i = 0; i < f; ++i) sum += s[i * 2];
+      *dst++ = (sum + n / 2) / n;
+    }
+}
+
+// ####################################################################################################
+// BT.601 video range YUV to RGB coefficients in 20-bit fixed point, exactly as used by cv::cvtColor(CV_YUV2BGR_YUYV),
+// so that downscaled conversions match full-resolution ones (factor 1) up to rounding:
+#define BT601_CY 1220542 // 1.164
+#define BT601_CUB 2116026 // 2.018
+#define BT601_CUG -409993 // -0.391
+#define BT601_CVG -852492 // -0.813
+#define BT601_CVR 1673527 // 1.596
+#define BT601_SHIFT 20
+
+static inline __attribute__((always_inline))
+void yuyvToBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f)
+{
+  // f is even, so each block covers f/2 complete Y U Y V macropixels on each of its rows:
+  unsigned int const ow = w / f, oh = h / f, n = f * f, stride = w * 2;
+  unsigned int x, y, i, j, sumy, sumu, sumv;
+  int Y, uf, vf, yc, R, G, B;
+
+  for (y = 0; y < oh; ++y, src += stride * f)
+    for (x = 0; x < ow; ++x)
+    {
+      unsigned char const * s = src + x * f * 2;
+      sumy = 0; sumu = 0; sumv = 0;
+      for (j = 0; j < f; ++j, s += stride)
+        for (i = 0; i < f * 2; i += 4) { sumy += s[i] + s[i + 2]; sumu += s[i + 1]; sumv += s[i + 3]; }
+
+      Y = (sumy + n / 2) / n; uf = (int)((sumu + n / 4) / (n / 2)) - 128; vf = (int)((sumv + n / 4) / (n / 2)) - 128;
+      yc = (Y > 16 ? Y - 16 : 0) * BT601_CY + (1 << (BT601_SHIFT - 1));
+      R = (yc + BT601_CVR * vf) >> BT601_SHIFT;
+      G = (yc + BT601_CVG * vf + BT601_CUG * uf) >> BT601_SHIFT;
+      B = (yc + BT601_CUB * uf) >> BT601_SHIFT;
+      CLAMP(R); CLAMP(G); CLAMP(B);
+      *dst++ = (unsigned char)(B); *dst++ = (unsigned char)(G); *dst++ = (unsigned char)(R);
+    }
 }
+
+// ####################################################################################################
+static inline __attribute__((always_inline))
+void rgb565Down(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f, int gray)
+{
+  unsigned int const ow = w / f, oh = h / f, n = f * f, stride = w * 2;
+  unsigned int x, y, i, j, sumr, sumg, sumb;
+  unsigned char r, g, b;
+
+  for (y = 0; y < oh; ++y, src += stride * f)
+    for (x = 0; x < ow; ++x)
+    {
+      unsigned char const * s = src + x * f * 2;
+      sumr = 0; sumg = 0; sumb = 0;
+      for (j = 0; j < f; ++j, s += stride)
+        for (i = 0; i < f; ++i) { rgb565pixrgb(s + i * 2, &r, &g, &b); sumr += r; sumg += g; sumb += b; }
+
+      sumr = (sumr + n / 2) / n; sumg = (sumg + n / 2) / n; sumb = (sumb + n / 2) / n;
+      if (gray) *dst++ = (sumr + sumg + sumb) / 3; // same as convertRGB565toGray()
+      else { *dst++ = sumb; *dst++ = sumg; *dst++ = sumr; }
+    }
+}
+
+static inline __attribute__((always_inline))
+void rgb565ToGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f)
+{ rgb565Down(w, h, src, dst, f, 1); }
+
+static inline __attribute__((always_inline))
+void rgb565ToBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f)
+{ rgb565Down(w, h, src, dst, f, 0); }
+
+// ####################################################################################################
+static inline __attribute__((always_inline))
+void bayerDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f, int gray)
+{
+  // RGGB pattern: even rows are R G R G..., odd rows are G B G B... Each block covers (f/2)^2 complete 2x2 cells, so
+  // we get the colors directly from the cells without any interpolation:
+  unsigned int const ow = w / f, oh = h / f, nc = (f / 2) * (f / 2), stride = w;
+  unsigned int x, y, i, j, sumr, sumg, sumb;
+
+  for (y = 0; y < oh; ++y, src += stride * f)
+    for (x = 0; x < ow; ++x)
+    {
+      unsigned char const * s = src + x * f;
+      sumr = 0; sumg = 0; sumb = 0;
+      for (j = 0; j < f; j += 2, s += stride * 2)
+        for (i = 0; i < f; i += 2) { sumr += s[i]; sumg += s[i + 1] + s[i + stride]; sumb += s[i + stride + 1]; }
+
+      sumr = (sumr + nc / 2) / nc; sumg = (sumg + nc) / (nc * 2); sumb = (sumb + nc / 2) / nc;
+      if (gray) *dst++ = (sumr * 4899 + sumg * 9617 + sumb * 1868 + 8192) >> 14; // same weights as OpenCV
+      else { *dst++ = sumb; *dst++ = sumg; *dst++ = sumr; }
+    }
+}
+
+static inline __attribute__((always_inline))
+void bayerToGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f)
+{ bayerDown(w, h, src, dst, f, 1); }
+
+static inline __attribute__((always_inline))
+void bayerToBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst, unsigned int f)
+{ bayerDown(w, h, src, dst, f, 0); }
+
+// ####################################################################################################
+void convertYUYVtoGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                           unsigned int factor)
+{ DOWN_DISPATCH(yuyvToGrayDown); }
+
+// ####################################################################################################
+void convertYUYVtoBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                          unsigned int factor)
+{ DOWN_DISPATCH(yuyvToBGRDown); }
+
+// ####################################################################################################
+void convertRGB565toGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                             unsigned int factor)
+{ DOWN_DISPATCH(rgb565ToGrayDown); }
+
+// ####################################################################################################
+void convertRGB565toBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                            unsigned int factor)
+{ DOWN_DISPATCH(rgb565ToBGRDown); }
+
+// ####################################################################################################
+void convertBayertoGrayDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                            unsigned int factor)
+{ DOWN_DISPATCH(bayerToGrayDown); }
+
+// ####################################################################################################
+void convertBayertoBGRDown(unsigned int w, unsigned int h, unsigned char const * src, unsigned char * dst,
+                           unsigned int factor)
+{ DOWN_DISPATCH(bayerToBGRDown); }